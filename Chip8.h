@@ -12,33 +12,170 @@
 // Copyright (C) 2011 Laurence Muller / www.multigesture.net
 ///////////////////////////////////////////////////////////////////////////////
 
-class chip8 {
+#include <stdint.h>
+#include <string>
+
+// Display size (SUPER-CHIP/XO-CHIP high-res mode is double in both axes)
+const int SCREEN_WIDTH  = 64;
+const int SCREEN_HEIGHT = 32;
+const int HIRES_WIDTH   = 128;
+const int HIRES_HEIGHT  = 64;
+
+// XO-CHIP extends the address space to 64k
+const int MEMORY_SIZE   = 65536;
+
+// Instructions executed per 60 Hz frame
+const int CYCLES_PER_FRAME = 10;
+
+// Debugger register ids: 0x0-0xF are V0-VF
+enum { REG_I = 16, REG_PC, REG_SP, REG_DT, REG_ST };
+
+// Debugger watchpoint access kinds (may be or'ed)
+enum { WATCH_READ = 1, WATCH_WRITE = 2 };
+
+// Debugger register condition comparisons
+enum { COND_EQ, COND_NE, COND_LT, COND_GT };
+
+// Why the debugger stopped
+enum { STOP_NONE, STOP_STEP, STOP_BREAKPOINT, STOP_WATCHPOINT, STOP_CONDITION, STOP_TARGET };
+
+// Interpreter quirks, where CHIP-8, SUPER-CHIP and XO-CHIP disagree (may be or'ed)
+enum {
+	QUIRK_VF_RESET = 1,		// 8XY1/8XY2/8XY3 clear VF
+	QUIRK_SHIFT_VX = 2,		// 8XY6/8XYE shift VX in place instead of VY into VX
+	QUIRK_KEEP_I   = 4,		// FX55/FX65 leave I unchanged instead of I + X + 1
+	QUIRK_JUMP_VX  = 8,		// BXNN jumps to XNN + VX instead of NNN + V0
+	QUIRK_ADDI_VF  = 16		// FX1E sets VF when I passes 0xFFF (Amiga interpreter,
+							// needed by Spacefight 2091!). In no profile
+};
+
+// Quirk profiles for setQuirks
+const int QUIRKS_CHIP8  = QUIRK_VF_RESET;
+const int QUIRKS_SCHIP  = QUIRK_SHIFT_VX | QUIRK_KEEP_I | QUIRK_JUMP_VX;
+const int QUIRKS_XOCHIP = 0;
+
+struct chip8Debug;
+
+// The whole machine. chip8 keeps its state in this one struct, so a save
+// state or a run-ahead copy is a single assignment. The keypad is host
+// input and stays outside
+struct chip8State {
+	bool           drawFlag;
+
+	// Packed framebuffer, one bit per pixel. Each row is 128 bits stored
+	// as two words (MSB of word 0 is the leftmost pixel), one layer per
+	// XO-CHIP bitplane. In low-res mode only word 0 of rows 0-31 is used.
+	uint64_t       gfx[2][HIRES_HEIGHT][2];
+
+	unsigned short pc;				// Program counter
+	unsigned short opcode;			// Current opcode
+	unsigned short I;				// Index register
+	unsigned short sp;				// Stack pointer
+
+	unsigned char  V[16];			// V-regs (V0-VF)
+	unsigned short stack[16];		// Stack (16 levels)
+	unsigned char  memory[MEMORY_SIZE];	// Memory (size = 64k)
+
+	unsigned char  delay_timer;		// Delay timer
+	unsigned char  sound_timer;		// Sound timer
+
+	bool           hires;			// 128x64 mode (00FF)
+	unsigned char  planes;			// Selected bitplanes (FN01)
+	unsigned char  flags[16];		// SCHIP RPL user flags (FX75/FX85)
+	unsigned char  audio[16];		// XO-CHIP audio pattern (F002)
+	unsigned char  pitch;			// XO-CHIP playback pitch (FX3A)
+	uint32_t       rng;				// CXNN generator state
+};
+
+class chip8 : private chip8State {
 	public:
 		chip8();
 		~chip8();
 
-		bool drawFlag;
+		// Owns its debugger, copy machine state with saveState/loadState
+		chip8(const chip8&) = delete;
+		chip8& operator=(const chip8&) = delete;
+
+		using chip8State::drawFlag;
 
 		void emulateCycle();
+		void emulateFrame(int cycles = CYCLES_PER_FRAME);
+		void updateTimers(bool beep = true);
 		void debugRender();
 		bool loadApplication(const char * filename);
 
+		// CXNN is reproducible after seeding, e.g. for regression runs
+		void seedRandom(unsigned int seed);
+
+		// A QUIRKS_ profile or QUIRK_ flags, XO-CHIP by default. A setting,
+		// not machine state: loadApplication and loadState keep it
+		void setQuirks(int q)	{ quirks = q; }
+
+		// Save states. Neither the debugger, the quirks nor key[] are part
+		// of the state
+		void saveState(chip8State& s) const;
+		void loadState(const chip8State& s);
+
+		// Run-ahead: run one real frame, then leave `ahead` as a copy of
+		// this machine, keys and quirks included, emulated `frames` further.
+		// Drawing `ahead` hides that many frames of the game's input lag.
+		// Speculative frames skip the debugger and don't beep
+		void runAhead(chip8& ahead, int frames, int cycles = CYCLES_PER_FRAME);
+
+		// Current display size, depends on 00FE/00FF
+		int  screenWidth() const	{ return hires ? HIRES_WIDTH  : SCREEN_WIDTH; }
+		int  screenHeight() const	{ return hires ? HIRES_HEIGHT : SCREEN_HEIGHT; }
+
+		// Colour of a pixel: bit 0 from plane 1, bit 1 from plane 2
+		int  getPixel(int x, int y) const;
+
+		// Debugger. Setting a breakpoint, watchpoint or condition makes
+		// emulateFrame run a separate debug loop that stops early when one
+		// is hit (see stopReason). The machine then stays stopped, and
+		// emulateFrame does nothing, until resume(). step and runUntil
+		// work while stopped. Timers tick every CYCLES_PER_FRAME debug
+		// instructions, in step with the plain loop. Once the last one is
+		// removed (or after clearDebug) and the machine isn't stopped,
+		// emulateFrame is back on the plain loop, see debugLoop
+		void addBreakpoint(unsigned short addr);
+		void removeBreakpoint(unsigned short addr);
+		void addWatchpoint(unsigned short first, unsigned short last, int access = WATCH_WRITE);
+		void removeWatchpoint(unsigned short first, unsigned short last, int access = WATCH_READ | WATCH_WRITE);
+		void addCondition(int reg, int cmp, unsigned short value);
+		void clearDebug();
+		void resume();
+		int  step();
+		int  runUntil(unsigned short addr, int maxCycles);
+		int  stopReason() const;
+		bool debugLoop() const;
+		int  getRegister(int reg) const;
+		unsigned char peek(unsigned short addr) const	{ return memory[addr]; }
+		std::string disassemble(unsigned short addr, int * length = NULL) const;
+
 // Chip8
-		unsigned char  gfx[64 * 32];	// Total amount of pixels: 2048
+		using chip8State::gfx;
 		unsigned char  key[16];
 
 	private:
-		unsigned short pc;				// Program counter
-		unsigned short opcode;			// Current opcode
-		unsigned short I;				// Index register
-		unsigned short sp;				// Stack pointer
+		int            quirks;			// QUIRK_ flags, see setQuirks
+		chip8Debug *   dbg;				// Debugger state, NULL when unused
 
-		unsigned char  V[16];			// V-regs (V0-VF)
-		unsigned short stack[16];		// Stack (16 levels)
-		unsigned char  memory[4096];	// Memory (size = 4k)
+		void initialize();
+		void skipNext();
+		void clearScreen();
+		void scrollDown(int n);
+		void scrollUp(int n);
+		void scrollLeft();
+		void scrollRight();
 
-		unsigned char  delay_timer;		// Delay timer
-		unsigned char  sound_timer;		// Sound timer
+		template <bool DEBUG> void execute();
+		template <bool DEBUG> unsigned char load(unsigned short addr);
+		template <bool DEBUG> void store(unsigned short addr, unsigned char value);
+		template <bool DEBUG> bool drawSprite(int x, int y, int height);
 
-		void initialize();
+		chip8Debug & debugger();
+		void headlessFrame(int cycles);
+
+		int  debugRun(int cycles, int target, int frameCycles, bool toFrameEnd);
+		void watchAccess(unsigned short addr, int access);
 };
@@ -5,20 +5,20 @@
 */
 
 #include <stdio.h>
+#include <string.h>
 #include <string>
 #include <random>
 #include "chip8.h"
 
-const int SCREEN_WIDTH  = 64;
-const int SCREEN_HEIGHT = 32;
-
 int i = 0;
 
 /*
 * systems memory map:
 * 0x000-0x1FF - Chip8 interpreter, contains font set in emu
-* 0x050-0x0A0 - Used for the built in 4x5 pixel font set (0-F)
+* 0x000-0x050 - Used for the built in 4x5 pixel font set (0-F)
+* 0x050-0x0F0 - Used for the SCHIP 8x10 pixel font set (0-F)
 * 0x200-0XFFF - Program ROM and work RAM
+* 0x1000-0xFFFF - XO-CHIP extended RAM
 */
 
 // chip8 font set. Each num or char is 4 px wide and 5 px high
@@ -41,14 +41,35 @@ unsigned char chip8_fontset[80] = {
   0xF0, 0x80, 0xF0, 0x80, 0x80  // F
 };
 
-chip8::chip8()
+// SCHIP big font set, 8 px wide and 10 px high. A-F are the XO-CHIP extension
+const int BIGFONT_ADDR = 0x50;
+unsigned char schip_fontset[160] = {
+  0x3C, 0x7E, 0xE7, 0xC3, 0xC3, 0xC3, 0xC3, 0xE7, 0x7E, 0x3C, // 0
+  0x18, 0x38, 0x58, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x3C, // 1
+  0x3E, 0x7F, 0xC3, 0x06, 0x0C, 0x18, 0x30, 0x60, 0xFF, 0xFF, // 2
+  0x3C, 0x7E, 0xC3, 0x03, 0x0E, 0x0E, 0x03, 0xC3, 0x7E, 0x3C, // 3
+  0x06, 0x0E, 0x1E, 0x36, 0x66, 0xC6, 0xFF, 0xFF, 0x06, 0x06, // 4
+  0xFF, 0xFF, 0xC0, 0xC0, 0xFC, 0xFE, 0x03, 0xC3, 0x7E, 0x3C, // 5
+  0x3E, 0x7C, 0xE0, 0xC0, 0xFC, 0xFE, 0xC3, 0xC3, 0x7E, 0x3C, // 6
+  0xFF, 0xFF, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x60, 0x60, // 7
+  0x3C, 0x7E, 0xC3, 0xC3, 0x7E, 0x7E, 0xC3, 0xC3, 0x7E, 0x3C, // 8
+  0x3C, 0x7E, 0xC3, 0xC3, 0x7F, 0x3F, 0x03, 0x03, 0x3E, 0x7C, // 9
+  0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, // A
+  0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, // B
+  0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C, // C
+  0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
+  0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // E
+  0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0  // F
+};
+
+chip8::chip8() : quirks(QUIRKS_XOCHIP), dbg(NULL)
 {
 	// empty
 }
 
 chip8::~chip8()
 {
-	// empty
+	clearDebug();
 }
 
 void chip8::initialize(){
@@ -64,47 +85,263 @@ void chip8::initialize(){
     delay_timer = 0;
     sound_timer = 0;
 
-    for (int i = 0; i < 80; ++i)
-        memory[i] = chip8_fontset[i];
+    hires = false;
+    planes = 0x1;
+    pitch = 64;
+
+    std::random_device rd;
+    seedRandom(rd());
+
     for (auto& k : key)
         k = 0;
     for (auto& m : memory)
         m = 0;
+    for (int i = 0; i < 80; ++i)
+        memory[i] = chip8_fontset[i];
+    for (int i = 0; i < 160; ++i)
+        memory[BIGFONT_ADDR + i] = schip_fontset[i];
     for (auto& r : V)
         r = 0;
     for (auto& l : stack)
         l = 0;
-    for (auto& p : gfx)
-        p = 0;
+    for (auto& f : flags)
+        f = 0;
+    for (auto& a : audio)
+        a = 0;
+    memset(gfx, 0, sizeof(gfx));
+
+    drawFlag = true;
+}
+
+// xorshift must not be seeded with 0
+void chip8::seedRandom(unsigned int seed){
+    rng = seed ? seed : 0x2545F491;
+}
+
+int chip8::getPixel(int x, int y) const{
+    // low-res pixels live in word 0, high-res rows span both words
+    auto word = x >> 6;
+    auto bit  = 63 - (x & 63);
+    return (int)((gfx[0][y][word] >> bit) & 1) |
+           (int)((gfx[1][y][word] >> bit) & 1) << 1;
+}
+
+// memory accesses made by instructions. watchpoints only see them in the
+// debugger's instantiation of the interpreter
+template <bool DEBUG>
+inline unsigned char chip8::load(unsigned short addr){
+    if (DEBUG)
+        watchAccess(addr, WATCH_READ);
+    return memory[addr];
+}
+
+template <bool DEBUG>
+inline void chip8::store(unsigned short addr, unsigned char value){
+    if (DEBUG)
+        watchAccess(addr, WATCH_WRITE);
+    memory[addr] = value;
+}
+
+// advance pc past the next instruction. XO-CHIP F000 NNNN is 4 bytes long
+void chip8::skipNext(){
+    unsigned short next = pc + 2;
+    if (memory[next] == 0xF0 && memory[(unsigned short)(next + 1)] == 0x00)
+        pc += 4;
+    else
+        pc += 2;
+}
+
+// clear the selected bitplanes
+void chip8::clearScreen(){
+    for (auto p = 0; p < 2; ++p)
+        if (planes & (1 << p))
+            memset(gfx[p], 0, sizeof(gfx[p]));
+    drawFlag = true;
+}
+
+// scrolls move whole rows (memmove) or whole words (shifts), never pixels
+void chip8::scrollDown(int n){
+    auto rows = screenHeight();
+    if (n > rows)
+        n = rows;
+    for (auto p = 0; p < 2; ++p){
+        if (!(planes & (1 << p)))
+            continue;
+        memmove(gfx[p][n], gfx[p][0], (rows - n) * sizeof(gfx[p][0]));
+        memset(gfx[p][0], 0, n * sizeof(gfx[p][0]));
+    }
+    drawFlag = true;
+}
+
+void chip8::scrollUp(int n){
+    auto rows = screenHeight();
+    if (n > rows)
+        n = rows;
+    for (auto p = 0; p < 2; ++p){
+        if (!(planes & (1 << p)))
+            continue;
+        memmove(gfx[p][0], gfx[p][n], (rows - n) * sizeof(gfx[p][0]));
+        memset(gfx[p][rows - n], 0, n * sizeof(gfx[p][0]));
+    }
+    drawFlag = true;
+}
+
+// 00FC: scroll 4 px left
+void chip8::scrollLeft(){
+    auto rows = screenHeight();
+    for (auto p = 0; p < 2; ++p){
+        if (!(planes & (1 << p)))
+            continue;
+        for (auto y = 0; y < rows; ++y){
+            gfx[p][y][0] = (gfx[p][y][0] << 4) | (gfx[p][y][1] >> 60);
+            gfx[p][y][1] <<= 4;
+        }
+    }
+    drawFlag = true;
+}
 
+// 00FB: scroll 4 px right. in low-res mode word 1 must stay blank
+void chip8::scrollRight(){
+    auto rows = screenHeight();
+    uint64_t keep = hires ? ~0ULL : 0;
+    for (auto p = 0; p < 2; ++p){
+        if (!(planes & (1 << p)))
+            continue;
+        for (auto y = 0; y < rows; ++y){
+            gfx[p][y][1] = ((gfx[p][y][1] >> 4) | (gfx[p][y][0] << 60)) & keep;
+            gfx[p][y][0] >>= 4;
+        }
+    }
     drawFlag = true;
 }
 
+// DXYN/DXY0: XOR a sprite into each selected plane, one row per step.
+// Each sprite row is shifted into a 128 bit mask so that collision test and
+// XOR are two word operations. Sprites wrap at the origin and clip at the
+// screen edges. Returns true on collision.
+template <bool DEBUG>
+bool chip8::drawSprite(int x, int y, int height){
+    auto width = (height == 0) ? 16 : 8;
+    auto rows  = (height == 0) ? 16 : height;
+    auto w = screenWidth();
+    auto h = screenHeight();
+    x &= w - 1;
+    y &= h - 1;
+
+    bool collision = false;
+    unsigned short addr = I;
+    for (auto p = 0; p < 2; ++p){
+        if (!(planes & (1 << p)))
+            continue;
+        for (auto yline = 0; yline < rows; ++yline){
+            // fetch the row and left-align it in a 64 bit word
+            uint64_t bits;
+            if (width == 16){
+                bits = (uint64_t)(load<DEBUG>(addr) << 8 | load<DEBUG>(addr + 1)) << 48;
+                addr += 2;
+            }
+            else{
+                bits = (uint64_t)load<DEBUG>(addr) << 56;
+                addr += 1;
+            }
+            if (y + yline >= h)
+                continue;
+
+            // shift to column x across the two words of the row
+            uint64_t hi = 0;
+            uint64_t lo = 0;
+            if (x >= 64)
+                lo = bits >> (x - 64);
+            else{
+                hi = bits >> x;
+                if (x > 0)
+                    lo = bits << (64 - x);
+            }
+            // low-res rows are only one word wide
+            if (!hires)
+                lo = 0;
+
+            auto& row = gfx[p][y + yline];
+            if ((row[0] & hi) | (row[1] & lo))
+                collision = true;
+            row[0] ^= hi;
+            row[1] ^= lo;
+        }
+    }
+    drawFlag = true;
+    return collision;
+}
+
 void chip8::emulateCycle(){
+    execute<false>();
+}
+
+// the interpreter. DEBUG=true is only instantiated for the debugger loop and
+// reports memory accesses to the watchpoints, DEBUG=false compiles them out
+template <bool DEBUG>
+void chip8::execute(){
 
     // fetch opcode
-    auto opcode = memory[pc] << 8 | memory[pc + 1];
+    opcode = memory[pc] << 8 | memory[(unsigned short)(pc + 1)];
 
     // decode opcode and execute opcodes
     switch(opcode & 0xF000){
 
         case 0x000:{
-            switch(opcode & 0x000F){
+            switch(opcode & 0x00FF){
                 // 0x00E0: clear screen
-                case 0x0000:
-                    for (auto& p : gfx)
-                        p = 0;
-                    drawFlag = true;
+                case 0x00E0:
+                    clearScreen();
                     pc += 2;
                     break;
                 // 0x00EE: return from subroutine
-                case 0x000E:
+                case 0x00EE:
                     --sp;
                     pc = stack[sp];
                     pc += 2;
                     break;
+                // 0x00FB: scroll right 4 px (SCHIP)
+                case 0x00FB:
+                    scrollRight();
+                    pc += 2;
+                    break;
+                // 0x00FC: scroll left 4 px (SCHIP)
+                case 0x00FC:
+                    scrollLeft();
+                    pc += 2;
+                    break;
+                // 0x00FD: exit interpreter (SCHIP). spin on this instruction
+                case 0x00FD:
+                    break;
+                // 0x00FE: low-res 64x32 mode (SCHIP)
+                // a mode switch clears every plane, not just the selected
+                // ones, so no pixels laid out for the old mode survive
+                case 0x00FE:
+                    hires = false;
+                    memset(gfx, 0, sizeof(gfx));
+                    drawFlag = true;
+                    pc += 2;
+                    break;
+                // 0x00FF: high-res 128x64 mode (SCHIP)
+                case 0x00FF:
+                    hires = true;
+                    memset(gfx, 0, sizeof(gfx));
+                    drawFlag = true;
+                    pc += 2;
+                    break;
                 default:
-                    printf("Unknown opcode [0x0000]: 0x%X\n", opcode);
+                    // 0x00CN: scroll down N px (SCHIP)
+                    if ((opcode & 0x00F0) == 0x00C0){
+                        scrollDown(opcode & 0x000F);
+                        pc += 2;
+                    }
+                    // 0x00DN: scroll up N px (XO-CHIP)
+                    else if ((opcode & 0x00F0) == 0x00D0){
+                        scrollUp(opcode & 0x000F);
+                        pc += 2;
+                    }
+                    else
+                        printf("Unknown opcode [0x0000]: 0x%X\n", opcode);
             }
             break;
         }
@@ -124,9 +361,8 @@ void chip8::emulateCycle(){
         // 3XNN: skip next instruction if VX == NN
         // usually next instr is jump to skip a code block
         case 0x3000:{
-            if (V[opcode & 0x0F00 >> 8] == (opcode & 0x00FF))
-                pc += 4;
-                break;
+            if (V[(opcode & 0x0F00) >> 8] == (opcode & 0x00FF))
+                skipNext();
             pc += 2;
             break;
         }
@@ -134,17 +370,46 @@ void chip8::emulateCycle(){
         // usually next instr is jump to skip a code block
         case 0x4000:{
             if (V[(opcode & 0x0F00) >> 8] != (opcode & 0x00FF))
-                pc += 4;
-                break;
+                skipNext();
             pc += 2;
             break;
         }
-        // 5XY0: skips next instruction if VX == VY
         case 0x5000:{
-            if (V[(opcode & 0x0F00) >> 8] == V[(opcode & 0x00F0) >> 4])
-                pc += 4;
-                break;
-            pc += 2;
+            auto x = (opcode & 0x0F00) >> 8;
+            auto y = (opcode & 0x00F0) >> 4;
+            switch (opcode & 0x000F){
+                // 5XY0: skips next instruction if VX == VY
+                case 0x0000:{
+                    if (V[x] == V[y])
+                        skipNext();
+                    pc += 2;
+                    break;
+                }
+                // 5XY2: store VX..VY in memory starting at I (XO-CHIP)
+                case 0x0002:{
+                    auto step = (x <= y) ? 1 : -1;
+                    for (auto r = x, n = 0; ; r += step, ++n){
+                        store<DEBUG>(I + n, V[r]);
+                        if (r == y)
+                            break;
+                    }
+                    pc += 2;
+                    break;
+                }
+                // 5XY3: load VX..VY from memory starting at I (XO-CHIP)
+                case 0x0003:{
+                    auto step = (x <= y) ? 1 : -1;
+                    for (auto r = x, n = 0; ; r += step, ++n){
+                        V[r] = load<DEBUG>(I + n);
+                        if (r == y)
+                            break;
+                    }
+                    pc += 2;
+                    break;
+                }
+                default:
+                    printf("Unknown opcode [0x5000]: 0x%X\n", opcode);
+            }
             break;
         }
         // 6XNN: set VX to NN
@@ -171,76 +436,91 @@ void chip8::emulateCycle(){
                 // 8XY1: Set VX to VX | VY
                 case 0x0001:{
                     V[(opcode & 0x0F00) >> 8] |= V[(opcode & 0x00F0) >> 4];
+                    if (quirks & QUIRK_VF_RESET)
+                        V[0xF] = 0;
                     pc += 2;
                     break;
                 }
                 // 8XY2: Set VX to VX & VY
                 case 0x0002:{
                     V[(opcode & 0x0F00) >> 8] &= V[(opcode & 0x00F0) >> 4];
+                    if (quirks & QUIRK_VF_RESET)
+                        V[0xF] = 0;
                     pc += 2;
                     break;
                 }
                 // 8XY3: Set VX to VX ^ VY
                 case 0x0003:{
                     V[(opcode & 0x0F00) >> 8] ^= V[(opcode & 0x00F0) >> 4];
+                    if (quirks & QUIRK_VF_RESET)
+                        V[0xF] = 0;
                     pc += 2;
                     break;
                 }
                 // 8XY4: Set VX to VX + VY. VF is set 1 to indicate a carry.
+                // VF is written last so 8FY4 ends up holding the flag
                 case 0x0004:{
-
-                    if (V[(opcode & 0x00F0) >> 4] > (0xFF - V[(opcode & 0x0F00) >> 8]))
-                        V[0xF] = 1; // carry
-                    else
-                        V[0xF] = 0;
-                    V[(opcode & 0x0F00) >> 8] += V[(opcode & 0x00F0) >> 4];
+                    auto x = (opcode & 0x0F00) >> 8;
+                    auto y = (opcode & 0x00F0) >> 4;
+                    unsigned char carry = (V[y] > (0xFF - V[x])) ? 1 : 0;
+                    V[x] += V[y];
+                    V[0xF] = carry;
                     pc += 2;
                     break;
                 }
                 // 8XY5: Set VX to VX - VY. VF is set 0 to indicate a borrow.
                 case 0x0005:{
-
-                    if (V[(opcode & 0x00F0) >> 4] > V[(opcode & 0x0F00) >> 8])
-                        V[0xF] = 0; // borrow
-                    else
-                        V[0xF] = 1;
-                    V[(opcode & 0x0F00) >> 8] -= V[(opcode & 0x00F0) >> 4];
+                    auto x = (opcode & 0x0F00) >> 8;
+                    auto y = (opcode & 0x00F0) >> 4;
+                    unsigned char noBorrow = (V[y] > V[x]) ? 0 : 1;
+                    V[x] -= V[y];
+                    V[0xF] = noBorrow;
                     pc += 2;
                     break;
                 }
-                // 0x8XY6: VX = Vy >> 1. VF set to rightmost VY bit before shift.
+                // 0x8XY6: VX = VY >> 1. VF set to rightmost bit before shift.
+                // SCHIP shifts VX in place (QUIRK_SHIFT_VX)
                 case 0x0006:{
-                    V[15] = (V[(opcode & 0x00F0) >> 4] & 0x0001);
-                    V[(opcode & 0x0F00) >> 8] >>= 1;
+                    auto x = (opcode & 0x0F00) >> 8;
+                    auto y = (quirks & QUIRK_SHIFT_VX) ? x : (opcode & 0x00F0) >> 4;
+                    unsigned char bit = V[y] & 0x01;
+                    V[x] = V[y] >> 1;
+                    V[0xF] = bit;
                     pc += 2;
                     break;
                 }
                 // 8XY7: Vx = VY - VX. VF is set 0 to indicate a borrow.
                 case 0x0007:{
-                    if (V[(opcode & 0x0F00) >> 8] > V[(opcode & 0x00F0) >> 4])
-                        V[0xF] = 0; // borrow
-                    else
-                        V[0xF] = 1;
-                    V[(opcode & 0x0F00) >> 8] = V[(opcode & 0x00F0) >> 4] - V[(opcode & 0x0F00) >> 8];
+                    auto x = (opcode & 0x0F00) >> 8;
+                    auto y = (opcode & 0x00F0) >> 4;
+                    unsigned char noBorrow = (V[x] > V[y]) ? 0 : 1;
+                    V[x] = V[y] - V[x];
+                    V[0xF] = noBorrow;
                     pc += 2;
                     break;
                 }
-                // 8XYE: VX = Vy = VY << 1. VF set to leftmost bit of VY before shift.
+                // 8XYE: VX = VY << 1. VF set to leftmost bit before shift.
+                // SCHIP shifts VX in place (QUIRK_SHIFT_VX)
                 case 0x000E:{
-                    V[0xF] = V[(opcode & 0x0F00) >> 8] >> 7;
-					V[(opcode & 0x0F00) >> 8] <<= 1;
-					pc += 2;
+                    auto x = (opcode & 0x0F00) >> 8;
+                    auto y = (quirks & QUIRK_SHIFT_VX) ? x : (opcode & 0x00F0) >> 4;
+                    unsigned char bit = V[y] >> 7;
+                    V[x] = V[y] << 1;
+                    V[0xF] = bit;
+                    pc += 2;
                     break;
                 }
+                default:
+                    printf("Unknown opcode [0x8000]: 0x%X\n", opcode);
             }
+            break;
         }
         // 9XY0: skip next instr if VX != VY
         // Usually next instruction is a jump to skip a code block
         case 0x9000:{
             if (V[(opcode & 0x0F00) >> 8] != V[(opcode & 0x00F0) >> 4])
-                pc += 4;
-            else
-                pc += 2;
+                skipNext();
+            pc += 2;
             break;
         }
         // ANNN: sets I to address NNN
@@ -250,49 +530,37 @@ void chip8::emulateCycle(){
             break;
         }
         // BNNN: PC = V0 + NNN. jumps to address NNN + V0.
+        // SCHIP reads it as BXNN, jumping to XNN + VX (QUIRK_JUMP_VX)
         case 0xB000:{
-            pc = V[0x0] + (opcode & 0x0FFF);
+            auto x = (quirks & QUIRK_JUMP_VX) ? (opcode & 0x0F00) >> 8 : 0;
+            pc = V[x] + (opcode & 0x0FFF);
             break;
         }
         // CXNN: VX = rand(0, 255) & NN.
+        // xorshift32, so the generator is part of the machine state and a
+        // seeded run is reproducible
         case 0xC000:{
-            std::random_device rd;
-            std::mt19937 mt(rd());
-            std::uniform_real_distribution<double> dist (0.0, 255.0);
-            V[(opcode & 0x0F00) >> 8] = dist(mt);
-            V[(opcode & 0x0F00) >> 8] &= (opcode & 0x00FF);
+            rng ^= rng << 13;
+            rng ^= rng >> 17;
+            rng ^= rng << 5;
+            V[(opcode & 0x0F00) >> 8] = (rng >> 24) & (opcode & 0x00FF);
             pc += 2;
             break;
         }
-        // DXYN: draw a pixel at coords VX, VY, that is N px high
+        // DXYN: draw a sprite at coords VX, VY, that is N px high
+        // DXY0: draw a 16x16 sprite (SCHIP)
+        // sprite bitcodes are at mem locations I onwards, one sprite per
+        // selected plane (XO-CHIP)
         case 0xD000:{
             // get VX
             auto x = V[(opcode & 0x0F00) >> 8];
             // get VY
             auto y = V[(opcode & 0x00F0) >> 4];
             auto height = opcode & 0x000F;
-            unsigned short pixel;
 
             // carry flag gets set to 1 if a collision occurs
-            V[0xF] = 0;
-            for (auto yline = 0; yline < height; yline++){
-                // sprite bitcodes will be at mem locations (I - I+height)
-                pixel = memory[I + yline];
-                for (auto xline = 0; xline < 8; xline++){
-                    // test if pixel is 1 (otherwise, do nothing)
-                    if ((pixel & (0x80 >> xline)) != 0){
-                        // test if display pixel is set to 1
-                        if (gfx[(x + xline + ((y + yline) * SCREEN_WIDTH))] == 1)
-                            V[0xF] = 1;
-                        // per spec, XOR the bit in memory with 1
-                        // we can hardcode 1 because we won't reach here if 0
-                        gfx[(x + xline + ((y + yline) * SCREEN_WIDTH))] ^= 1;
-                    }
-                }
-            }
-            drawFlag = true;
+            V[0xF] = drawSprite<DEBUG>(x, y, height) ? 1 : 0;
             pc += 2;
-
             break;
         }
         case 0xE000:{
@@ -300,25 +568,50 @@ void chip8::emulateCycle(){
                 // EX9E: skip next instr if key stored in VX is pressed
                 // usually next instruction is jump to skip a code block
                 case 0x009E:{
-                    if (key[V[(opcode & 0x0F00) >> 8]] != 0)
-                        pc += 4;
-                    else
-                        pc += 2;
+                    if (key[V[(opcode & 0x0F00) >> 8] & 0xF] != 0)
+                        skipNext();
+                    pc += 2;
                     break;
                 }
                 // EXA1: skip next instr if key stored in VX is NOT pressed
                 // usually next instruction is jump to skip a code block
                 case 0x00A1:{
-                    if (key[V[(opcode & 0x0F00) >> 8]] == 0)
-                        pc += 4;
-                    else
-                        pc += 2;
+                    if (key[V[(opcode & 0x0F00) >> 8] & 0xF] == 0)
+                        skipNext();
+                    pc += 2;
                     break;
                 }
+                default:
+                    printf("Unknown opcode [0xE000]: 0x%X\n", opcode);
             }
+            break;
         }
         case 0xF000:{
             switch (opcode & 0x00FF){
+                // F000 NNNN: set I to the 16 bit address NNNN (XO-CHIP)
+                // only X == 0 is defined, matching skipNext/disassemble
+                case 0x0000:{
+                    if (opcode != 0xF000){
+                        printf("Unknown opcode [0xF000]: 0x%X\n", opcode);
+                        break;
+                    }
+                    I = memory[(unsigned short)(pc + 2)] << 8 | memory[(unsigned short)(pc + 3)];
+                    pc += 4;
+                    break;
+                }
+                // FN01: select bitplanes N for drawing (XO-CHIP)
+                case 0x0001:{
+                    planes = (opcode & 0x0F00) >> 8;
+                    pc += 2;
+                    break;
+                }
+                // F002: load 16 byte audio pattern from I (XO-CHIP)
+                case 0x0002:{
+                    for (auto i = 0; i < 16; ++i)
+                        audio[i] = load<DEBUG>(I + i);
+                    pc += 2;
+                    break;
+                }
                 // FX07: set VX to the value of the delay timer
                 case 0x0007:{
                     V[(opcode & 0x0F00) >> 8] = delay_timer;
@@ -358,12 +651,11 @@ void chip8::emulateCycle(){
                     pc += 2;
                     break;
                 }
-                // FX1E: add VX to I
+                // FX1E: add VX to I. VF is left alone, with 64k memory
+                // an I past 0xFFF is no overflow
                 case 0x001E:{
-                    if(I + V[(opcode & 0x0F00) >> 8] > 0xFFF)	// VF is set to 1 when range overflow (I+VX>0xFFF), and 0 when there isn't.
-						V[0xF] = 1;
-					else
-						V[0xF] = 0;
+                    if(quirks & QUIRK_ADDI_VF)	// VF is set to 1 when range overflow (I+VX>0xFFF), and 0 when there isn't.
+						V[0xF] = (I + V[(opcode & 0x0F00) >> 8] > 0xFFF) ? 1 : 0;
                     I += V[(opcode & 0x0F00) >> 8];
                     pc += 2;
                     break;
@@ -375,58 +667,137 @@ void chip8::emulateCycle(){
 					pc += 2;
                     break;
                 }
+                // FX30: set I to the 8x10 big font sprite for digit in VX (SCHIP)
+                case 0x0030:{
+                    I = BIGFONT_ADDR + (V[(opcode & 0x0F00) >> 8] & 0xF) * 10;
+                    pc += 2;
+                    break;
+                }
+                // FX3A: set audio pattern playback pitch to VX (XO-CHIP)
+                case 0x003A:{
+                    pitch = V[(opcode & 0x0F00) >> 8];
+                    pc += 2;
+                    break;
+                }
                 // FX33: store binary-coded decimal representation of VX at
                 // memory address I, I + 1, I + 2 (hundreds, tens, ones digits resp.)
                 case 0x0033:{
-                    memory[I] = V[(opcode & 0x0F00) >> 8] / 100;
-                    memory[I + 1] = (V[(opcode & 0x0F00) >> 8] / 10) % 10;
-                    memory[I + 2] = (V[(opcode & 0x0F00) >> 8] % 100) % 10;
+                    store<DEBUG>(I, V[(opcode & 0x0F00) >> 8] / 100);
+                    store<DEBUG>(I + 1, (V[(opcode & 0x0F00) >> 8] / 10) % 10);
+                    store<DEBUG>(I + 2, (V[(opcode & 0x0F00) >> 8] % 100) % 10);
                     pc += 2;
                     break;
                 }
                 // FX55: stores [V0 - VX] in memory starting at addr I
                 case 0x0055:{
                     for (auto i = 0; i <= ((opcode & 0x0F00) >> 8); ++i)
-						memory[I + i] = V[i];
+						store<DEBUG>(I + i, V[i]);
 
 					// On the original interpreter, when the operation is done, I = I + X + 1.
-					I += ((opcode & 0x0F00) >> 8) + 1;
+					// SCHIP leaves I alone (QUIRK_KEEP_I)
+					if (!(quirks & QUIRK_KEEP_I))
+						I += ((opcode & 0x0F00) >> 8) + 1;
 					pc += 2;
                     break;
                 }
                 // FX65: loads [V0 - VX] from memory starting at addr I
                 case 0x0065:{
                     for (auto i = 0; i <= ((opcode & 0x0F00) >> 8); ++i)
-						V[i] = memory[I + i];
+						V[i] = load<DEBUG>(I + i);
 
 					// On the original interpreter, when the operation is done, I = I + X + 1.
-					I += ((opcode & 0x0F00) >> 8) + 1;
+					// SCHIP leaves I alone (QUIRK_KEEP_I)
+					if (!(quirks & QUIRK_KEEP_I))
+						I += ((opcode & 0x0F00) >> 8) + 1;
 					pc += 2;
                     break;
                 }
+                // FX75: store [V0 - VX] in the RPL user flags (SCHIP)
+                case 0x0075:{
+                    for (auto i = 0; i <= ((opcode & 0x0F00) >> 8); ++i)
+                        flags[i] = V[i];
+                    pc += 2;
+                    break;
+                }
+                // FX85: load [V0 - VX] from the RPL user flags (SCHIP)
+                case 0x0085:{
+                    for (auto i = 0; i <= ((opcode & 0x0F00) >> 8); ++i)
+                        V[i] = flags[i];
+                    pc += 2;
+                    break;
+                }
+                default:
+                    printf("Unknown opcode [0xF000]: 0x%X\n", opcode);
             }
+            break;
         }
         default:
             printf("Unknown opcode: 0x%X\n", opcode);
     }
+}
 
-    // update timers
+// timers count down at 60 Hz, independent of the instruction rate
+void chip8::updateTimers(bool beep){
     if (delay_timer > 0)
         --delay_timer;
     if (sound_timer > 0){
-        if (sound_timer == 1)
+        if (sound_timer == 1 && beep)
             printf("BEEP!");
         --sound_timer;
     }
 }
 
+template void chip8::execute<false>();
+template void chip8::execute<true>();
+
+// run one frame worth of instructions, e.g. from a 60 Hz host loop
+void chip8::emulateFrame(int cycles){
+    // the debugger gets its own loop, which also ticks the timers, so this
+    // one stays check-free. once nothing is set any more it's bypassed
+    if (debugLoop()){
+        if (stopReason() == STOP_NONE)
+            debugRun(0, -1, cycles, true);
+        return;
+    }
+    for (auto n = 0; n < cycles; ++n)
+        execute<false>();
+    updateTimers();
+}
+
+// speculative frames for run-ahead: always the plain loop, and the timers
+// count down without beeping
+void chip8::headlessFrame(int cycles){
+    for (auto n = 0; n < cycles; ++n)
+        execute<false>();
+    updateTimers(false);
+}
+
+void chip8::saveState(chip8State& s) const{
+    s = *this;
+}
+
+void chip8::loadState(const chip8State& s){
+    chip8State::operator=(s);
+}
+
+// instead of snapshotting, running ahead and restoring this machine, the
+// speculative frames run on a copy, which saves the restore
+void chip8::runAhead(chip8& ahead, int frames, int cycles){
+    emulateFrame(cycles);
+    ahead.loadState(*this);
+    memcpy(ahead.key, key, sizeof(key));
+    ahead.quirks = quirks;
+    for (auto f = 0; f < frames; ++f)
+        ahead.headlessFrame(cycles);
+}
+
 void chip8::debugRender() {
 	// Draw
-	for(int y = 0; y < 32; ++y)
+	for(int y = 0; y < screenHeight(); ++y)
 	{
-		for(int x = 0; x < 64; ++x)
+		for(int x = 0; x < screenWidth(); ++x)
 		{
-			if(gfx[(y*64) + x] == 0)
+			if(getPixel(x, y) == 0)
 				printf("O");
 			else
 				printf(" ");
@@ -471,7 +842,7 @@ bool chip8::loadApplication(const char * filename) {
 	}
 
 	// Copy buffer to Chip8 memory
-	if((4096-512) > lSize)
+	if((MEMORY_SIZE-512) > lSize)
 	{
 		for(int i = 0; i < lSize; ++i)
 			memory[i + 512] = buffer[i];
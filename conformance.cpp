@@ -0,0 +1,368 @@
+/*
+*   conformance.cpp
+*   Runs a corpus of ROMs headless on every engine in parallel, compares the
+*   final framebuffer and machine state against stored golden hashes and
+*   reports per-ROM runtime
+*   By Brian Mansfield
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include "chip8.h"
+
+/*
+* manifest format, one ROM per line, '#' starts a comment:
+*
+*   <rom> <frames> <framebuffer hash> <state hash> [quirks] [input]
+*
+* rom paths are relative to the manifest. a hash of '-' is not checked and
+* gets filled in by --update, and a missing ROM without goldens is skipped.
+* --update leaves a ROM alone when its engines disagree. quirks is one of
+* chip8, schip or xochip (the default). input is a comma separated list of
+* <frame>:<key><+|-> events, e.g. 60:5+,64:5- presses key 5 at frame 60
+* and releases it at frame 64. every run uses the same CXNN seed.
+*/
+
+const unsigned int TEST_SEED = 0xC8C8C8C8;
+
+// the debug engine keeps a breakpoint at an address ROMs never execute, so
+// the debugger loop runs without stopping. the runahead engine runs two
+// speculative frames per real one, and the real machine must not notice
+enum { ENGINE_FAST, ENGINE_DEBUG, ENGINE_RUNAHEAD, ENGINE_COUNT };
+const char * engineNames[ENGINE_COUNT] = { "fast", "debug", "runahead" };
+
+const int RUNAHEAD_FRAMES = 2;
+
+struct quirkProfile {
+    const char * name;
+    int quirks;
+};
+const quirkProfile profiles[] = {
+    { "chip8",  QUIRKS_CHIP8 },
+    { "schip",  QUIRKS_SCHIP },
+    { "xochip", QUIRKS_XOCHIP }
+};
+
+struct keyEvent {
+    int frame;
+    int key;
+    bool pressed;
+};
+
+struct testCase {
+    std::string line;           // manifest line, kept for --update
+    std::string rom;
+    int frames;
+    std::string fbGolden;
+    std::string stateGolden;
+    std::string options;        // everything after the hashes, kept for --update
+    int quirks;
+    std::vector<keyEvent> events;
+
+    // results, one per engine
+    uint64_t fbHash[ENGINE_COUNT];
+    uint64_t stateHash[ENGINE_COUNT];
+    double seconds[ENGINE_COUNT];
+    bool loaded[ENGINE_COUNT];
+    bool agree;                 // loaded and the same hashes on every engine
+};
+
+// FNV-1a
+static uint64_t hashBytes(uint64_t h, const void * data, size_t size){
+    auto p = (const unsigned char *)data;
+    for (size_t i = 0; i < size; ++i){
+        h ^= p[i];
+        h *= 0x100000001B3ULL;
+    }
+    return h;
+}
+
+const uint64_t FNV_OFFSET = 0xCBF29CE484222325ULL;
+
+// multi-byte values go in little-endian, so the goldens are the same on
+// every host
+static uint64_t hashValue(uint64_t h, uint64_t v, int size){
+    for (auto i = 0; i < size; ++i){
+        unsigned char b = (unsigned char)(v >> (8 * i));
+        h = hashBytes(h, &b, 1);
+    }
+    return h;
+}
+
+// only the visible part of the framebuffer, plus the display mode
+static uint64_t framebufferHash(const chip8& c8){
+    auto h = hashValue(FNV_OFFSET, c8.screenWidth(), 4);
+    for (auto p = 0; p < 2; ++p)
+        for (auto y = 0; y < c8.screenHeight(); ++y)
+            for (auto word = 0; word < 2; ++word)
+                h = hashValue(h, c8.gfx[p][y][word], 8);
+    return h;
+}
+
+// every field of the machine state but the framebuffer, which has its own
+// hash, so an engine that corrupts any of it disagrees with 'fast'
+static uint64_t stateHash(const chip8& c8){
+    chip8State * s = new chip8State();
+    c8.saveState(*s);
+
+    auto h = FNV_OFFSET;
+    h = hashValue(h, s->pc, 2);
+    h = hashValue(h, s->opcode, 2);
+    h = hashValue(h, s->I, 2);
+    h = hashValue(h, s->sp, 2);
+    h = hashBytes(h, s->V, sizeof(s->V));
+    for (auto level : s->stack)
+        h = hashValue(h, level, 2);
+    h = hashBytes(h, s->memory, sizeof(s->memory));
+    h = hashValue(h, s->delay_timer, 1);
+    h = hashValue(h, s->sound_timer, 1);
+    h = hashValue(h, s->hires, 1);
+    h = hashValue(h, s->planes, 1);
+    h = hashBytes(h, s->flags, sizeof(s->flags));
+    h = hashBytes(h, s->audio, sizeof(s->audio));
+    h = hashValue(h, s->pitch, 1);
+    h = hashValue(h, s->rng, 4);
+
+    delete s;
+    return h;
+}
+
+static bool parseInput(const std::string& text, std::vector<keyEvent>& events){
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ',')){
+        keyEvent e;
+        char state;
+        if (sscanf(item.c_str(), "%d:%x%c", &e.frame, &e.key, &state) != 3 || (state != '+' && state != '-'))
+            return false;
+        e.key &= 0xF;
+        e.pressed = (state == '+');
+        events.push_back(e);
+    }
+    return true;
+}
+
+static bool loadManifest(const char * path, std::vector<testCase>& cases, std::vector<std::string>& lines){
+    std::ifstream in(path);
+    if (!in){
+        fprintf(stderr, "Can't open manifest %s\n", path);
+        return false;
+    }
+    std::string dir(path);
+    auto slash = dir.find_last_of('/');
+    dir = (slash == std::string::npos) ? "" : dir.substr(0, slash + 1);
+
+    std::string line;
+    for (auto n = 1; std::getline(in, line); ++n){
+        lines.push_back(line);
+        auto text = line.substr(0, line.find('#'));
+        std::stringstream ss(text);
+        testCase t;
+        if (!(ss >> t.rom))
+            continue;
+        if (!(ss >> t.frames >> t.fbGolden >> t.stateGolden)){
+            fprintf(stderr, "%s:%d: expected <rom> <frames> <fb hash> <state hash> [quirks] [input]\n", path, n);
+            return false;
+        }
+        t.quirks = QUIRKS_XOCHIP;
+        t.agree = false;
+        std::string option;
+        while (ss >> option){
+            t.options += " " + option;
+            bool profile = false;
+            for (auto& q : profiles){
+                if (option == q.name){
+                    t.quirks = q.quirks;
+                    profile = true;
+                }
+            }
+            if (profile)
+                continue;
+            if (!parseInput(option, t.events)){
+                fprintf(stderr, "%s:%d: bad input script '%s'\n", path, n, option.c_str());
+                return false;
+            }
+        }
+        t.line = line;
+        t.rom = dir + t.rom;
+        cases.push_back(t);
+    }
+    return true;
+}
+
+static void runCase(testCase& t, int engine){
+    chip8 * c8 = new chip8();
+    t.loaded[engine] = c8->loadApplication(t.rom.c_str());
+    if (!t.loaded[engine]){
+        delete c8;
+        return;
+    }
+    c8->seedRandom(TEST_SEED);
+    c8->setQuirks(t.quirks);
+    if (engine == ENGINE_DEBUG)
+        c8->addBreakpoint(MEMORY_SIZE - 1);
+    chip8 * ahead = (engine == ENGINE_RUNAHEAD) ? new chip8() : NULL;
+
+    size_t next = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (auto f = 0; f < t.frames; ++f){
+        for (; next < t.events.size() && t.events[next].frame <= f; ++next)
+            c8->key[t.events[next].key] = t.events[next].pressed ? 1 : 0;
+        if (ahead)
+            c8->runAhead(*ahead, RUNAHEAD_FRAMES);
+        else
+            c8->emulateFrame();
+    }
+    auto stop = std::chrono::steady_clock::now();
+    delete ahead;
+
+    t.seconds[engine] = std::chrono::duration<double>(stop - start).count();
+    t.fbHash[engine] = framebufferHash(*c8);
+    t.stateHash[engine] = stateHash(*c8);
+    delete c8;
+}
+
+static std::string hex(uint64_t h){
+    char buf[17];
+    snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)h);
+    return buf;
+}
+
+int main(int argc, char **argv)
+{
+    const char * manifest = NULL;
+    bool update = false;
+    unsigned jobs = std::thread::hardware_concurrency();
+
+    for (auto i = 1; i < argc; ++i){
+        if (!strcmp(argv[i], "--update"))
+            update = true;
+        else if (!strcmp(argv[i], "--jobs") && i + 1 < argc)
+            jobs = atoi(argv[++i]);
+        else
+            manifest = argv[i];
+    }
+    if (!manifest){
+        printf("Usage: ./chip8test [--update] [--jobs N] <manifest>\n\n");
+        return 1;
+    }
+    if (jobs == 0)
+        jobs = 1;
+
+    std::vector<testCase> cases;
+    std::vector<std::string> lines;
+    if (!loadManifest(manifest, cases, lines))
+        return 1;
+
+    // every (ROM, engine) pair is an independent job
+    std::atomic<size_t> nextJob(0);
+    auto total = cases.size() * ENGINE_COUNT;
+    std::vector<std::thread> workers;
+    for (unsigned w = 0; w < jobs; ++w){
+        workers.push_back(std::thread([&](){
+            for (size_t j; (j = nextJob++) < total; )
+                runCase(cases[j / ENGINE_COUNT], j % ENGINE_COUNT);
+        }));
+    }
+    for (auto& w : workers)
+        w.join();
+
+    int failed = 0;
+    int skipped = 0;
+    double engineSeconds[ENGINE_COUNT] = { 0 };
+    long long cycles = 0;
+    printf("\n");
+    for (auto& t : cases){
+        // listed for users to add themselves, and not added yet
+        if (!t.loaded[ENGINE_FAST] && t.fbGolden == "-" && t.stateGolden == "-"){
+            printf("SKIP  %s\n", t.rom.c_str());
+            ++skipped;
+            continue;
+        }
+
+        std::string problem;
+        for (auto e = 0; e < ENGINE_COUNT && problem.empty(); ++e){
+            if (!t.loaded[e])
+                problem = "can't load ROM";
+            else if (t.fbHash[e] != t.fbHash[ENGINE_FAST] || t.stateHash[e] != t.stateHash[ENGINE_FAST])
+                problem = std::string("engine '") + engineNames[e] + "' disagrees with 'fast'";
+        }
+        t.agree = problem.empty();
+        if (!t.agree && update)
+            problem += ", goldens not updated";
+        auto fb = hex(t.fbHash[ENGINE_FAST]);
+        auto state = hex(t.stateHash[ENGINE_FAST]);
+        if (problem.empty() && !update){
+            if (t.fbGolden != "-" && t.fbGolden != fb)
+                problem = "framebuffer " + fb + ", expected " + t.fbGolden;
+            else if (t.stateGolden != "-" && t.stateGolden != state)
+                problem = "state " + state + ", expected " + t.stateGolden;
+        }
+
+        printf("%s  %s", problem.empty() ? "PASS" : "FAIL", t.rom.c_str());
+        for (auto e = 0; e < ENGINE_COUNT; ++e){
+            if (!t.loaded[e])
+                continue;
+            printf("  %s %.2f ms", engineNames[e], t.seconds[e] * 1000.0);
+            engineSeconds[e] += t.seconds[e];
+        }
+        printf("\n");
+        if (!problem.empty()){
+            printf("      %s\n", problem.c_str());
+            ++failed;
+        }
+        cycles += (long long)t.frames * CYCLES_PER_FRAME;
+    }
+
+    printf("\n%d of %d ROMs passed", (int)cases.size() - skipped - failed, (int)cases.size() - skipped);
+    if (skipped)
+        printf(", %d skipped", skipped);
+    printf("\n");
+    // rates count the cycles of real frames. run-ahead also emulates
+    // RUNAHEAD_FRAMES speculative frames for each of them
+    for (auto e = 0; e < ENGINE_COUNT; ++e){
+        if (engineSeconds[e] <= 0)
+            continue;
+        auto rate = cycles / engineSeconds[e] / 1e6;
+        printf("%-8s %.2f Mcycles/s", engineNames[e], rate);
+        if (e == ENGINE_RUNAHEAD)
+            printf(" of real frames, %.2f with the speculative ones", rate * (1 + RUNAHEAD_FRAMES));
+        printf("\n");
+    }
+
+    if (update){
+        // rewrite the hash columns, leaving comments and everything else alone
+        std::ofstream out(manifest);
+        size_t c = 0;
+        for (auto& line : lines){
+            if (c < cases.size() && line == cases[c].line){
+                auto& t = cases[c++];
+                // no golden gets recorded from engines that disagree
+                if (!t.agree){
+                    out << line << "\n";
+                    continue;
+                }
+                std::string rom = line.substr(0, line.find_first_of(" \t", line.find_first_not_of(" \t")));
+                out << rom << " " << t.frames << " " << hex(t.fbHash[ENGINE_FAST]) << " "
+                    << hex(t.stateHash[ENGINE_FAST]) << t.options;
+                auto comment = line.find('#');
+                if (comment != std::string::npos)
+                    out << "   " << line.substr(comment);
+                out << "\n";
+            }
+            else
+                out << line << "\n";
+        }
+        printf("\nUpdated %s\n", manifest);
+    }
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,304 @@
+/*
+*   debugger.cpp
+*   Breakpoints, watchpoints, register conditions and a disassembler for
+*   the chip8 interpreter
+*   By Brian Mansfield
+*/
+
+#include <stdio.h>
+#include <vector>
+#include "chip8.h"
+
+struct chip8Debug {
+    struct condition {
+        int reg;
+        int cmp;
+        unsigned short value;
+        bool was;               // result after the previous instruction
+    };
+
+    // one flag byte per address, so a lookup is a single load
+    unsigned char breakpoints[MEMORY_SIZE];
+    unsigned char watch[MEMORY_SIZE];
+    std::vector<condition> conditions;
+
+    int breakCount;
+    int watchCount;             // addresses with any watch flag set
+    int reason;
+    int frameDone;              // instructions run in the current frame
+    bool resume;                // stopped on a breakpoint, run it next time
+
+    bool active() const { return breakCount || watchCount || !conditions.empty(); }
+};
+
+static bool compare(int a, int cmp, int b){
+    switch (cmp){
+        case COND_EQ: return a == b;
+        case COND_NE: return a != b;
+        case COND_LT: return a < b;
+        case COND_GT: return a > b;
+    }
+    return false;
+}
+
+chip8Debug & chip8::debugger(){
+    // value-initialised, so every table starts zeroed
+    if (!dbg)
+        dbg = new chip8Debug();
+    return *dbg;
+}
+
+void chip8::clearDebug(){
+    delete dbg;
+    dbg = NULL;
+}
+
+void chip8::addBreakpoint(unsigned short addr){
+    auto& d = debugger();
+    if (!d.breakpoints[addr])
+        ++d.breakCount;
+    d.breakpoints[addr] = 1;
+}
+
+void chip8::removeBreakpoint(unsigned short addr){
+    if (!dbg || !dbg->breakpoints[addr])
+        return;
+    dbg->breakpoints[addr] = 0;
+    --dbg->breakCount;
+}
+
+void chip8::addWatchpoint(unsigned short first, unsigned short last, int access){
+    auto& d = debugger();
+    if (first > last){
+        auto t = first;
+        first = last;
+        last = t;
+    }
+    for (int a = first; a <= last; ++a){
+        if (!d.watch[a] && access)
+            ++d.watchCount;
+        d.watch[a] |= access;
+    }
+}
+
+void chip8::removeWatchpoint(unsigned short first, unsigned short last, int access){
+    if (!dbg)
+        return;
+    if (first > last){
+        auto t = first;
+        first = last;
+        last = t;
+    }
+    for (int a = first; a <= last; ++a){
+        if (dbg->watch[a] && !(dbg->watch[a] & ~access))
+            --dbg->watchCount;
+        dbg->watch[a] &= ~access;
+    }
+}
+
+// stops when the comparison becomes true, not on every instruction it holds
+void chip8::addCondition(int reg, int cmp, unsigned short value){
+    auto& d = debugger();
+    chip8Debug::condition c = { reg, cmp, value, false };
+    c.was = compare(getRegister(reg), cmp, value);
+    d.conditions.push_back(c);
+}
+
+int chip8::step(){
+    auto reason = debugRun(1, -1, CYCLES_PER_FRAME, false);
+    if (reason == STOP_NONE)
+        dbg->reason = reason = STOP_STEP;
+    return reason;
+}
+
+int chip8::runUntil(unsigned short addr, int maxCycles){
+    return debugRun(maxCycles, addr, CYCLES_PER_FRAME, false);
+}
+
+// let emulateFrame continue after a stop. a frame that was cut short runs
+// only its remaining instructions
+void chip8::resume(){
+    if (dbg)
+        dbg->reason = STOP_NONE;
+}
+
+// the debug loop is needed while anything is set, while stopped, and to
+// finish a frame it cut short, so the timers keep their phase
+bool chip8::debugLoop() const{
+    return dbg && (dbg->active() || dbg->reason != STOP_NONE || dbg->frameDone != 0);
+}
+
+int chip8::stopReason() const{
+    return dbg ? dbg->reason : STOP_NONE;
+}
+
+int chip8::getRegister(int reg) const{
+    if (reg >= 0 && reg < 16)
+        return V[reg];
+    switch (reg){
+        case REG_I:  return I;
+        case REG_PC: return pc;
+        case REG_SP: return sp;
+        case REG_DT: return delay_timer;
+        case REG_ST: return sound_timer;
+    }
+    return -1;
+}
+
+// called from execute<true> for every instruction memory access
+void chip8::watchAccess(unsigned short addr, int access){
+    if (dbg->watch[addr] & access)
+        dbg->reason = STOP_WATCHPOINT;
+}
+
+// run up to cycles instructions (or to the end of the current frame when
+// toFrameEnd is set), stopping before a breakpoint, after an instruction that
+// hit a watchpoint or condition, or when pc reaches target. the timers tick
+// whenever frameCycles instructions have run, wherever the stops fall
+int chip8::debugRun(int cycles, int target, int frameCycles, bool toFrameEnd){
+    auto& d = debugger();
+    d.reason = STOP_NONE;
+
+    for (auto n = 0; toFrameEnd || n < cycles; ++n){
+        if (d.breakpoints[pc] && !d.resume){
+            d.resume = true;
+            d.reason = STOP_BREAKPOINT;
+            break;
+        }
+        d.resume = false;
+
+        execute<true>();
+
+        for (auto& c : d.conditions){
+            auto now = compare(getRegister(c.reg), c.cmp, c.value);
+            if (now && !c.was)
+                d.reason = STOP_CONDITION;
+            c.was = now;
+        }
+        if (d.reason == STOP_NONE && pc == target)
+            d.reason = STOP_TARGET;
+
+        bool frameEnd = ++d.frameDone >= frameCycles;
+        if (frameEnd){
+            d.frameDone = 0;
+            updateTimers();
+        }
+        if (d.reason != STOP_NONE || (frameEnd && toFrameEnd))
+            break;
+    }
+    return d.reason;
+}
+
+// one instruction in Cowgod's mnemonics, SCHIP/XO-CHIP extensions included,
+// read the way the current quirks execute it. length is set to the
+// instruction size in bytes
+std::string chip8::disassemble(unsigned short addr, int * length) const{
+    unsigned short op = memory[addr] << 8 | memory[(unsigned short)(addr + 1)];
+    auto x   = (op & 0x0F00) >> 8;
+    auto y   = (op & 0x00F0) >> 4;
+    auto n   = op & 0x000F;
+    auto nn  = op & 0x00FF;
+    auto nnn = op & 0x0FFF;
+    char buf[32];
+
+    if (length)
+        *length = 2;
+
+    switch (op & 0xF000){
+        case 0x0000:{
+            switch (op){
+                case 0x00E0: return "CLS";
+                case 0x00EE: return "RET";
+                case 0x00FB: return "SCR";
+                case 0x00FC: return "SCL";
+                case 0x00FD: return "EXIT";
+                case 0x00FE: return "LOW";
+                case 0x00FF: return "HIGH";
+            }
+            if ((op & 0xFFF0) == 0x00C0)
+                snprintf(buf, sizeof(buf), "SCD %d", n);
+            else if ((op & 0xFFF0) == 0x00D0)
+                snprintf(buf, sizeof(buf), "SCU %d", n);
+            else
+                snprintf(buf, sizeof(buf), "SYS 0x%03X", nnn);
+            break;
+        }
+        case 0x1000: snprintf(buf, sizeof(buf), "JP 0x%03X", nnn); break;
+        case 0x2000: snprintf(buf, sizeof(buf), "CALL 0x%03X", nnn); break;
+        case 0x3000: snprintf(buf, sizeof(buf), "SE V%X, 0x%02X", x, nn); break;
+        case 0x4000: snprintf(buf, sizeof(buf), "SNE V%X, 0x%02X", x, nn); break;
+        case 0x5000:{
+            switch (n){
+                case 0x0: snprintf(buf, sizeof(buf), "SE V%X, V%X", x, y); break;
+                case 0x2: snprintf(buf, sizeof(buf), "SAVE V%X-V%X", x, y); break;
+                case 0x3: snprintf(buf, sizeof(buf), "LOAD V%X-V%X", x, y); break;
+                default:  snprintf(buf, sizeof(buf), "DW 0x%04X", op);
+            }
+            break;
+        }
+        case 0x6000: snprintf(buf, sizeof(buf), "LD V%X, 0x%02X", x, nn); break;
+        case 0x7000: snprintf(buf, sizeof(buf), "ADD V%X, 0x%02X", x, nn); break;
+        case 0x8000:{
+            static const char * alu[16] = {
+                "LD", "OR", "AND", "XOR", "ADD", "SUB", "SHR", "SUBN",
+                NULL, NULL, NULL, NULL, NULL, NULL, "SHL", NULL
+            };
+            if (alu[n])
+                snprintf(buf, sizeof(buf), "%s V%X, V%X", alu[n], x, y);
+            else
+                snprintf(buf, sizeof(buf), "DW 0x%04X", op);
+            break;
+        }
+        case 0x9000: snprintf(buf, sizeof(buf), "SNE V%X, V%X", x, y); break;
+        case 0xA000: snprintf(buf, sizeof(buf), "LD I, 0x%03X", nnn); break;
+        case 0xB000:
+            if (quirks & QUIRK_JUMP_VX)
+                snprintf(buf, sizeof(buf), "JP V%X, 0x%03X", x, nnn);
+            else
+                snprintf(buf, sizeof(buf), "JP V0, 0x%03X", nnn);
+            break;
+        case 0xC000: snprintf(buf, sizeof(buf), "RND V%X, 0x%02X", x, nn); break;
+        case 0xD000: snprintf(buf, sizeof(buf), "DRW V%X, V%X, %d", x, y, n); break;
+        case 0xE000:{
+            if (nn == 0x9E)
+                snprintf(buf, sizeof(buf), "SKP V%X", x);
+            else if (nn == 0xA1)
+                snprintf(buf, sizeof(buf), "SKNP V%X", x);
+            else
+                snprintf(buf, sizeof(buf), "DW 0x%04X", op);
+            break;
+        }
+        case 0xF000:{
+            switch (nn){
+                case 0x00:
+                    if (x == 0){
+                        if (length)
+                            *length = 4;
+                        snprintf(buf, sizeof(buf), "LD I, 0x%04X",
+                                 memory[(unsigned short)(addr + 2)] << 8 | memory[(unsigned short)(addr + 3)]);
+                    }
+                    else
+                        snprintf(buf, sizeof(buf), "DW 0x%04X", op);
+                    break;
+                case 0x01: snprintf(buf, sizeof(buf), "PLANE %d", x); break;
+                case 0x02: snprintf(buf, sizeof(buf), "AUDIO"); break;
+                case 0x07: snprintf(buf, sizeof(buf), "LD V%X, DT", x); break;
+                case 0x0A: snprintf(buf, sizeof(buf), "LD V%X, K", x); break;
+                case 0x15: snprintf(buf, sizeof(buf), "LD DT, V%X", x); break;
+                case 0x18: snprintf(buf, sizeof(buf), "LD ST, V%X", x); break;
+                case 0x1E: snprintf(buf, sizeof(buf), "ADD I, V%X", x); break;
+                case 0x29: snprintf(buf, sizeof(buf), "LD F, V%X", x); break;
+                case 0x30: snprintf(buf, sizeof(buf), "LD HF, V%X", x); break;
+                case 0x33: snprintf(buf, sizeof(buf), "LD B, V%X", x); break;
+                case 0x3A: snprintf(buf, sizeof(buf), "PITCH V%X", x); break;
+                case 0x55: snprintf(buf, sizeof(buf), "LD [I], V%X", x); break;
+                case 0x65: snprintf(buf, sizeof(buf), "LD V%X, [I]", x); break;
+                case 0x75: snprintf(buf, sizeof(buf), "LD R, V%X", x); break;
+                case 0x85: snprintf(buf, sizeof(buf), "LD V%X, R", x); break;
+                default:   snprintf(buf, sizeof(buf), "DW 0x%04X", op);
+            }
+            break;
+        }
+    }
+    return buf;
+}
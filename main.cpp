@@ -13,16 +13,18 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <GLUT/glut.h>
 #include "chip8.h"
 
-// Display size
-#define SCREEN_WIDTH 64
-#define SCREEN_HEIGHT 32
-
 chip8 myChip8;
 int modifier = 10;
 
+// Run-ahead: show a copy emulated this many frames into the future
+chip8 aheadChip8;
+int runAheadFrames = 0;
+
 // Window size
 int display_width = SCREEN_WIDTH * modifier;
 int display_height = SCREEN_HEIGHT * modifier;
@@ -35,19 +37,26 @@ void keyboardDown(unsigned char key, int x, int y);
 // Use new drawing method
 #define DRAWWITHTEXTURE
 typedef unsigned __int8 u8;
-u8 screenData[SCREEN_HEIGHT][SCREEN_WIDTH][3];
+u8 screenData[HIRES_HEIGHT][HIRES_WIDTH][3];
 void setupTexture();
 
 int main(int argc, char **argv)
 {
-	if(argc < 2)
+	int game = 1;
+	if(argc > 3 && strcmp(argv[1], "-runahead") == 0)
 	{
-		printf("Usage: ./myChip8 <game>\n\n");
+		runAheadFrames = atoi(argv[2]);
+		game = 3;
+	}
+
+	if(argc < game + 1)
+	{
+		printf("Usage: ./myChip8 [-runahead <frames>] <game>\n\n");
 		return 1;
 	}
 
 	// Load game
-	if(!myChip8.loadApplication(argv[1]))
+	if(!myChip8.loadApplication(argv[game]))
 		return 1;
 
 	// Setup OpenGL
@@ -77,12 +86,12 @@ int main(int argc, char **argv)
 void setupTexture()
 {
 	// Clear screen
-	for(int y = 0; y < SCREEN_HEIGHT; ++y)
-		for(int x = 0; x < SCREEN_WIDTH; ++x)
+	for(int y = 0; y < HIRES_HEIGHT; ++y)
+		for(int x = 0; x < HIRES_WIDTH; ++x)
 			screenData[y][x][0] = screenData[y][x][1] = screenData[y][x][2] = 0;
 
-	// Create a texture
-	glTexImage2D(GL_TEXTURE_2D, 0, 3, SCREEN_WIDTH, SCREEN_HEIGHT, 0, GL_RGB, GL_UNSIGNED_BYTE, (GLvoid*)screenData);
+	// Create a texture, always high-res sized. Low-res pixels are doubled
+	glTexImage2D(GL_TEXTURE_2D, 0, 3, HIRES_WIDTH, HIRES_HEIGHT, 0, GL_RGB, GL_UNSIGNED_BYTE, (GLvoid*)screenData);
 
 	// Set up the texture
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
@@ -94,18 +103,19 @@ void setupTexture()
 	glEnable(GL_TEXTURE_2D);
 }
 
+// XO-CHIP plane colours: off, plane 1, plane 2, both
+const u8 palette[4] = { 0, 255, 170, 85 };
+
 void updateTexture(const chip8& c8)
 {
 	// Update pixels
-	for(int y = 0; y < 32; ++y)
-		for(int x = 0; x < 64; ++x)
-			if(c8.gfx[(y * 64) + x] == 0)
-				screenData[y][x][0] = screenData[y][x][1] = screenData[y][x][2] = 0;	// Disabled
-			else
-				screenData[y][x][0] = screenData[y][x][1] = screenData[y][x][2] = 255;  // Enabled
+	int shift = (c8.screenWidth() == HIRES_WIDTH) ? 0 : 1;
+	for(int y = 0; y < HIRES_HEIGHT; ++y)
+		for(int x = 0; x < HIRES_WIDTH; ++x)
+			screenData[y][x][0] = screenData[y][x][1] = screenData[y][x][2] = palette[c8.getPixel(x >> shift, y >> shift)];
 
 	// Update Texture
-	glTexSubImage2D(GL_TEXTURE_2D, 0 ,0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, GL_RGB, GL_UNSIGNED_BYTE, (GLvoid*)screenData);
+	glTexSubImage2D(GL_TEXTURE_2D, 0 ,0, 0, HIRES_WIDTH, HIRES_HEIGHT, GL_RGB, GL_UNSIGNED_BYTE, (GLvoid*)screenData);
 
 	glBegin( GL_QUADS );
 		glTexCoord2d(0.0, 0.0);		glVertex2d(0.0,			  0.0);
@@ -116,44 +126,58 @@ void updateTexture(const chip8& c8)
 }
 
 // Old gfx code
-void drawPixel(int x, int y)
+void drawPixel(int x, int y, float size)
 {
 	glBegin(GL_QUADS);
-		glVertex3f((x * modifier) + 0.0f,     (y * modifier) + 0.0f,	 0.0f);
-		glVertex3f((x * modifier) + 0.0f,     (y * modifier) + modifier, 0.0f);
-		glVertex3f((x * modifier) + modifier, (y * modifier) + modifier, 0.0f);
-		glVertex3f((x * modifier) + modifier, (y * modifier) + 0.0f,	 0.0f);
+		glVertex3f((x * size) + 0.0f, (y * size) + 0.0f, 0.0f);
+		glVertex3f((x * size) + 0.0f, (y * size) + size, 0.0f);
+		glVertex3f((x * size) + size, (y * size) + size, 0.0f);
+		glVertex3f((x * size) + size, (y * size) + 0.0f, 0.0f);
 	glEnd();
 }
 
 void updateQuads(const chip8& c8)
 {
-	// Draw
-	for(int y = 0; y < 32; ++y)
-		for(int x = 0; x < 64; ++x)
+	// Draw, high-res pixels are half size
+	float size = (float)modifier * SCREEN_WIDTH / c8.screenWidth();
+	for(int y = 0; y < c8.screenHeight(); ++y)
+		for(int x = 0; x < c8.screenWidth(); ++x)
 		{
-			if(c8.gfx[(y*64) + x] == 0)
-				glColor3f(0.0f,0.0f,0.0f);
-			else
-				glColor3f(1.0f,1.0f,1.0f);
+			float c = palette[c8.getPixel(x, y)] / 255.0f;
+			glColor3f(c, c, c);
 
-			drawPixel(x, y);
+			drawPixel(x, y, size);
 		}
 }
 
 void display()
 {
-	myChip8.emulateCycle();
-
-	if(myChip8.drawFlag)
+	// Run one frame per 60 Hz tick, the idle callback fires far more often
+	static int lastFrame = 0;
+	int now = glutGet(GLUT_ELAPSED_TIME);
+	if(now - lastFrame < 16)
+		return;
+	lastFrame = now;
+
+	if(runAheadFrames > 0)
+		myChip8.runAhead(aheadChip8, runAheadFrames);
+	else
+		myChip8.emulateFrame();
+
+	// The speculative copy is rebuilt every frame and can differ from the
+	// one shown last even when nothing drew (e.g. a key was released), so
+	// in run-ahead mode it is presented every frame
+	const chip8& screen = (runAheadFrames > 0) ? aheadChip8 : myChip8;
+
+	if(runAheadFrames > 0 || screen.drawFlag)
 	{
 		// Clear framebuffer
 		glClear(GL_COLOR_BUFFER_BIT);
 
 #ifdef DRAWWITHTEXTURE
-		updateTexture(myChip8);
+		updateTexture(screen);
 #else
-		updateQuads(myChip8);
+		updateQuads(screen);
 #endif
 
 		// Swap buffers!
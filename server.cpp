@@ -0,0 +1,44 @@
+/*
+*   server.cpp
+*   Runs chip8 games headless and streams them to viewers, see stream.h
+*   By Brian Mansfield
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "chip8.h"
+#include "stream.h"
+
+int main(int argc, char **argv)
+{
+	if(argc < 3)
+	{
+		printf("Usage: ./chip8server <port | socket path> <game> [game ...]\n\n");
+		return 1;
+	}
+
+	chip8Server server;
+
+	// a number is a loopback TCP port, anything else a Unix socket path
+	char * end;
+	long port = strtol(argv[1], &end, 10);
+	bool ok = (*end == '\0') ? server.listenTcp((unsigned short)port) : server.listenUnix(argv[1]);
+	if(!ok)
+		return 1;
+
+	// instance ids follow the order of the games on the command line
+	for(int i = 2; i < argc; ++i)
+	{
+		chip8 * c8 = new chip8();
+		if(!c8->loadApplication(argv[i]))
+			return 1;
+		server.addInstance(c8);
+	}
+
+	server.start();
+	for(;;)
+		pause();
+
+	return 0;
+}
@@ -0,0 +1,329 @@
+/*
+*   stream.cpp
+*   Delta-encoded framebuffer streaming server, see stream.h for the protocol
+*   By Brian Mansfield
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <chrono>
+#include "chip8.h"
+#include "stream.h"
+
+// a viewer that can't keep up skips frames instead of buffering them
+const size_t MAX_BACKLOG = 64 * 1024;
+
+const auto FRAME_TIME = std::chrono::microseconds(16667);
+
+struct viewer {
+    int fd;
+    int instance;           // subscribed instance, -1 until 'S'
+    bool dirty;             // instance drew since the last frame we sent
+    bool keyframe;          // next frame sends every row
+    bool hires;             // display mode of the last frame sent
+    uint64_t shadow[2][HIRES_HEIGHT][2];    // framebuffer as the viewer has it
+    std::vector<unsigned char> in;
+    std::vector<unsigned char> out;
+};
+
+static bool setNonBlocking(int fd){
+    auto fl = fcntl(fd, F_GETFL, 0);
+    return fl != -1 && fcntl(fd, F_SETFL, fl | O_NONBLOCK) != -1;
+}
+
+chip8Server::chip8Server() : running(false)
+{
+	// empty
+}
+
+chip8Server::~chip8Server()
+{
+    stop();
+    for (auto v : viewers){
+        close(v->fd);
+        delete v;
+    }
+    for (auto fd : listeners)
+        close(fd);
+}
+
+bool chip8Server::listenTcp(unsigned short port){
+    auto fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0){
+        perror("socket");
+        return false;
+    }
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 128) < 0 || !setNonBlocking(fd)){
+        perror("listen");
+        close(fd);
+        return false;
+    }
+    listeners.push_back(fd);
+    return true;
+}
+
+bool chip8Server::listenUnix(const char * path){
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)){
+        fprintf(stderr, "Socket path too long: %s\n", path);
+        return false;
+    }
+    strcpy(addr.sun_path, path);
+
+    // replace a socket left behind by an earlier run, but nothing else
+    struct stat st;
+    if (lstat(path, &st) == 0){
+        if (!S_ISSOCK(st.st_mode)){
+            fprintf(stderr, "%s exists and is not a socket\n", path);
+            return false;
+        }
+        unlink(path);
+    }
+
+    auto fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0){
+        perror("socket");
+        return false;
+    }
+    if (bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 128) < 0 || !setNonBlocking(fd)){
+        perror("listen");
+        close(fd);
+        return false;
+    }
+    listeners.push_back(fd);
+    return true;
+}
+
+int chip8Server::addInstance(chip8 * c8){
+    instances.push_back(c8);
+    return (int)instances.size() - 1;
+}
+
+void chip8Server::start(){
+    if (running)
+        return;
+    // a viewer hanging up must not kill the server
+    signal(SIGPIPE, SIG_IGN);
+    running = true;
+    worker = std::thread(&chip8Server::run, this);
+}
+
+void chip8Server::stop(){
+    running = false;
+    if (worker.joinable())
+        worker.join();
+}
+
+void chip8Server::run(){
+    std::vector<pollfd> fds;
+    auto next = std::chrono::steady_clock::now();
+
+    while (running){
+        auto now = std::chrono::steady_clock::now();
+        if (now >= next){
+            tick();
+            next += FRAME_TIME;
+            // don't try to catch up after a stall
+            if (next < now)
+                next = now + FRAME_TIME;
+        }
+
+        fds.clear();
+        for (auto fd : listeners)
+            fds.push_back({ fd, POLLIN, 0 });
+        for (auto v : viewers)
+            fds.push_back({ v->fd, (short)(v->out.empty() ? POLLIN : POLLIN | POLLOUT), 0 });
+
+        // round up, a timeout truncated to 0 ms would spin through the
+        // last fraction of a millisecond before every tick
+        auto left = std::chrono::duration_cast<std::chrono::microseconds>(next - std::chrono::steady_clock::now()).count();
+        auto wait = left > 0 ? (int)((left + 999) / 1000) : 0;
+        if (poll(fds.data(), fds.size(), wait) <= 0)
+            continue;
+
+        auto n = listeners.size();
+        for (size_t i = 0; i < n; ++i)
+            if (fds[i].revents & POLLIN)
+                acceptViewers(fds[i].fd);
+
+        // fds past the listeners line up with viewers as they were before
+        // acceptViewers appended the new ones
+        size_t kept = 0;
+        auto polled = fds.size() - n;
+        for (size_t i = 0; i < viewers.size(); ++i){
+            auto v = viewers[i];
+            bool ok = true;
+            if (i < polled){
+                auto ev = fds[n + i].revents;
+                if (ev & (POLLERR | POLLNVAL))
+                    ok = false;
+                if (ok && (ev & (POLLIN | POLLHUP)))
+                    ok = readViewer(*v);
+                if (ok && (ev & POLLOUT))
+                    ok = flushViewer(*v);
+            }
+            if (ok)
+                viewers[kept++] = v;
+            else{
+                close(v->fd);
+                delete v;
+            }
+        }
+        viewers.resize(kept);
+    }
+}
+
+// step every instance by one frame and publish what changed
+void chip8Server::tick(){
+    for (auto c8 : instances)
+        c8->emulateFrame();
+
+    for (auto v : viewers){
+        if (v->instance < 0)
+            continue;
+        if (instances[v->instance]->drawFlag)
+            v->dirty = true;
+        if (v->dirty && v->out.size() < MAX_BACKLOG){
+            encodeFrame(*v);
+            flushViewer(*v);
+        }
+    }
+
+    for (auto c8 : instances)
+        c8->drawFlag = false;
+}
+
+void chip8Server::acceptViewers(int fd){
+    for (;;){
+        auto c = accept(fd, NULL, NULL);
+        if (c < 0)
+            return;
+        if (!setNonBlocking(c)){
+            close(c);
+            continue;
+        }
+        auto v = new viewer();
+        v->fd = c;
+        v->instance = -1;
+        viewers.push_back(v);
+    }
+}
+
+// returns false when the viewer hung up or sent garbage
+bool chip8Server::readViewer(viewer& v){
+    unsigned char buf[512];
+    for (;;){
+        auto n = recv(v.fd, buf, sizeof(buf), 0);
+        if (n == 0)
+            return false;
+        if (n < 0){
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            return false;
+        }
+        v.in.insert(v.in.end(), buf, buf + n);
+    }
+
+    // every message is 3 bytes
+    size_t i = 0;
+    for (; i + 3 <= v.in.size(); i += 3){
+        switch (v.in[i]){
+            case 'S':{
+                auto id = v.in[i + 1] << 8 | v.in[i + 2];
+                if (id >= (int)instances.size())
+                    return false;
+                v.instance = id;
+                v.keyframe = true;
+                v.dirty = true;
+                break;
+            }
+            case 'K':{
+                if (v.instance >= 0)
+                    instances[v.instance]->key[v.in[i + 1] & 0xF] = v.in[i + 2] ? 1 : 0;
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+    v.in.erase(v.in.begin(), v.in.begin() + i);
+    return true;
+}
+
+bool chip8Server::flushViewer(viewer& v){
+    size_t sent = 0;
+    while (sent < v.out.size()){
+        auto n = send(v.fd, v.out.data() + sent, v.out.size() - sent, 0);
+        if (n < 0){
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            return false;
+        }
+        sent += n;
+    }
+    v.out.erase(v.out.begin(), v.out.begin() + sent);
+    return true;
+}
+
+// append the rows that differ from the viewer's shadow framebuffer. a mode
+// switch or a new subscription sends every row
+void chip8Server::encodeFrame(viewer& v){
+    const chip8& c8 = *instances[v.instance];
+    bool hires = c8.screenWidth() == HIRES_WIDTH;
+    bool full = v.keyframe || hires != v.hires;
+    auto rows = c8.screenHeight();
+    auto words = hires ? 2 : 1;
+
+    auto head = v.out.size();
+    v.out.push_back('F');
+    v.out.push_back(hires ? 1 : 0);
+    v.out.push_back(0);
+    v.out.push_back(0);
+
+    unsigned short count = 0;
+    for (auto p = 0; p < 2; ++p){
+        for (auto y = 0; y < rows; ++y){
+            const uint64_t * row = c8.gfx[p][y];
+            auto& shadow = v.shadow[p][y];
+            if (!full && row[0] == shadow[0] && row[1] == shadow[1])
+                continue;
+            v.out.push_back((unsigned char)(p << 7 | y));
+            for (auto w = 0; w < words; ++w)
+                for (auto b = 7; b >= 0; --b)
+                    v.out.push_back((unsigned char)(row[w] >> (b * 8)));
+            shadow[0] = row[0];
+            shadow[1] = row[1];
+            ++count;
+        }
+    }
+
+    if (count == 0)
+        v.out.resize(head);
+    else{
+        v.out[head + 2] = count >> 8;
+        v.out[head + 3] = count & 0xFF;
+    }
+    v.hires = hires;
+    v.keyframe = false;
+    v.dirty = false;
+}
@@ -0,0 +1,63 @@
+/*
+*   stream.h
+*   Streams the framebuffers of headless chip8 instances to viewers over a
+*   loopback TCP or Unix domain socket
+*   By Brian Mansfield
+*/
+
+#include <vector>
+#include <thread>
+#include <atomic>
+
+/*
+* protocol, all multi-byte values are big endian:
+*
+* viewer -> server
+*   'S' id(2)       subscribe to instance id, the next frame is a full frame
+*   'K' key state   set key[key & 0xF] of the subscribed instance to state
+*
+* server -> viewer
+*   'F' hires count(2) then count rows of: (plane << 7 | y) bits(8 or 16)
+*
+* only rows that changed since the last frame sent to that viewer are
+* included (bits are 8 bytes per row in low-res, 16 in high-res, MSB is the
+* leftmost pixel). nothing is sent while the instance's drawFlag is unset.
+*/
+
+class chip8;
+struct viewer;
+
+class chip8Server {
+	public:
+		chip8Server();
+		~chip8Server();
+
+		// Listen on 127.0.0.1:port or a Unix domain socket at path.
+		// May be called more than once before start()
+		bool listenTcp(unsigned short port);
+		bool listenUnix(const char * path);
+
+		// Instances must be added before start() and are only touched by
+		// the server thread while it runs. Returns the instance id
+		int  addInstance(chip8 * c8);
+
+		// Runs every instance at 60 Hz and serves all viewers from a
+		// single thread using non-blocking I/O
+		void start();
+		void stop();
+
+	private:
+		std::vector<int>     listeners;
+		std::vector<chip8*>  instances;
+		std::vector<viewer*> viewers;
+
+		std::thread          worker;
+		std::atomic<bool>    running;
+
+		void run();
+		void tick();
+		void acceptViewers(int fd);
+		bool readViewer(viewer& v);
+		bool flushViewer(viewer& v);
+		void encodeFrame(viewer& v);
+};
@@ -0,0 +1,157 @@
+/*
+*   debugger_test.cpp
+*   Checks breakpoints, resume, single step, watchpoints and edge-triggered
+*   register conditions, that the debug loop keeps the timers in step
+*   with the plain loop across stops, and that removing the last of them
+*   returns to the plain loop. Also checks the disassembler
+*   By Brian Mansfield
+*/
+
+#include <stdio.h>
+#include "chip8.h"
+
+const char * ROM_PATH = "/tmp/chip8_debugger_test.ch8";
+
+// counts V0 up and stores it at 0x300, with the delay timer running
+const unsigned char rom[] = {
+    0x6A, 0xFF,     // 200: LD VA, 0xFF
+    0xFA, 0x15,     // 202: LD DT, VA
+    0xA3, 0x00,     // 204: LD I, 0x300     <- loop
+    0x70, 0x01,     // 206: ADD V0, 1
+    0xF0, 0x55,     // 208: LD [I], V0
+    0x12, 0x04,     // 20A: JP 0x204
+
+    // never run, only disassembled
+    0xB2, 0x40,     // 20C: JP V0, 0x240 (JP V2, 0x240 with QUIRK_JUMP_VX)
+    0xF0, 0x00,     // 20E: LD I, 0xABCD
+    0xAB, 0xCD,
+    0x00, 0xC3      // 212: SCD 3
+};
+
+int failed = 0;
+
+static void check(bool ok, const char * what){
+    printf("%s  %s\n", ok ? "PASS" : "FAIL", what);
+    if (!ok)
+        ++failed;
+}
+
+static bool load(chip8& c8){
+    FILE * f = fopen(ROM_PATH, "wb");
+    if (!f)
+        return false;
+    fwrite(rom, 1, sizeof(rom), f);
+    fclose(f);
+    return c8.loadApplication(ROM_PATH);
+}
+
+static bool sameRegisters(const chip8& a, const chip8& b){
+    for (auto r = 0; r <= REG_ST; ++r)
+        if (a.getRegister(r) != b.getRegister(r))
+            return false;
+    return true;
+}
+
+int main()
+{
+    chip8 * c8 = new chip8();
+    if (!load(*c8))
+        return 1;
+    printf("\n");
+
+    // breakpoints stop before the instruction and hold the machine
+    c8->addBreakpoint(0x208);
+    c8->emulateFrame();
+    check(c8->stopReason() == STOP_BREAKPOINT && c8->getRegister(REG_PC) == 0x208 && c8->getRegister(0) == 1,
+          "breakpoint stops before its instruction");
+    c8->emulateFrame();
+    check(c8->getRegister(REG_PC) == 0x208 && c8->getRegister(0) == 1, "emulateFrame does nothing while stopped");
+
+    check(c8->step() == STOP_STEP && c8->getRegister(REG_PC) == 0x20A, "step runs the breakpoint's instruction");
+    c8->emulateFrame();
+    check(c8->getRegister(REG_PC) == 0x20A, "the machine stays stopped after a step");
+
+    c8->resume();
+    c8->emulateFrame();
+    check(c8->stopReason() == STOP_BREAKPOINT && c8->getRegister(REG_PC) == 0x208 && c8->getRegister(0) == 2,
+          "resume continues to the next hit");
+
+    // watchpoints stop after the access
+    c8->clearDebug();
+    c8->addWatchpoint(0x300, 0x300, WATCH_WRITE);
+    c8->emulateFrame();
+    check(c8->stopReason() == STOP_WATCHPOINT && c8->getRegister(REG_PC) == 0x20A && c8->peek(0x300) == 2,
+          "write watchpoint stops after the store");
+    c8->clearDebug();
+    c8->addWatchpoint(0x300, 0x300, WATCH_READ);
+    c8->emulateFrame();
+    check(c8->stopReason() == STOP_NONE, "read watchpoint ignores writes");
+
+    // conditions fire when they become true, not while they hold
+    c8->clearDebug();
+    c8->addCondition(0, COND_GT, 50);
+    for (auto f = 0; f < 40 && c8->stopReason() == STOP_NONE; ++f)
+        c8->emulateFrame();
+    check(c8->stopReason() == STOP_CONDITION && c8->getRegister(0) == 51, "condition stops when it becomes true");
+    c8->resume();
+    for (auto f = 0; f < 20; ++f)
+        c8->emulateFrame();
+    check(c8->stopReason() == STOP_NONE && c8->getRegister(0) > 51, "condition doesn't fire again while it holds");
+    delete c8;
+
+    // a breakpoint hit every loop cuts frames short, but the timers must
+    // only tick once per completed frame, like the plain loop
+    chip8 * plain = new chip8();
+    chip8 * debug = new chip8();
+    if (!load(*plain) || !load(*debug))
+        return 1;
+    debug->addBreakpoint(0x206);
+    auto stops = 0;
+    for (auto frames = 0; frames < 20; ){
+        debug->emulateFrame();
+        if (debug->stopReason() == STOP_NONE)
+            ++frames;
+        else{
+            ++stops;
+            debug->resume();
+        }
+    }
+    for (auto f = 0; f < 20; ++f)
+        plain->emulateFrame();
+    check(stops > 20 && sameRegisters(*plain, *debug), "timers stay in step with the plain loop across stops");
+
+    // removing the last breakpoint or watchpoint goes back to the plain
+    // loop, once the frame the debugger cut short is finished
+    debug->emulateFrame();
+    debug->resume();
+    debug->removeBreakpoint(0x206);
+    check(debug->debugLoop(), "a cut short frame is still finished by the debug loop");
+    debug->emulateFrame();
+    plain->emulateFrame();
+    check(!debug->debugLoop() && sameRegisters(*plain, *debug), "removing the last breakpoint returns to the plain loop");
+    debug->addWatchpoint(0x300, 0x301);
+    debug->removeWatchpoint(0x300, 0x300);
+    check(debug->debugLoop(), "a partly removed watchpoint keeps the debug loop");
+    debug->removeWatchpoint(0x301, 0x301, WATCH_WRITE);
+    check(!debug->debugLoop(), "removing the last watched address returns to the plain loop");
+    delete plain;
+    delete debug;
+
+    // the disassembler, including an instruction that follows the quirks
+    // and one that is 4 bytes long
+    chip8 * dis = new chip8();
+    if (!load(*dis))
+        return 1;
+    int length;
+    check(dis->disassemble(0x208, &length) == "LD [I], V0" && length == 2, "disassembles FX55");
+    check(dis->disassemble(0x20A) == "JP 0x204", "disassembles 1NNN");
+    check(dis->disassemble(0x20C) == "JP V0, 0x240", "disassembles BNNN");
+    dis->setQuirks(QUIRKS_SCHIP);
+    check(dis->disassemble(0x20C) == "JP V2, 0x240", "disassembles BXNN under QUIRK_JUMP_VX");
+    check(dis->disassemble(0x20E, &length) == "LD I, 0xABCD" && length == 4, "F000 NNNN is 4 bytes long");
+    check(dis->disassemble(0x212, &length) == "SCD 3" && length == 2, "disassembles 00CN");
+    delete dis;
+
+    printf("\n%s\n", failed ? "FAILED" : "OK");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,218 @@
+/*
+*   stream_test.cpp
+*   Checks the streaming protocol end to end: keyframe on subscribe, delta
+*   rows, 'K' key events, a keyframe on a mode switch, silence while nothing
+*   draws, that served instances run their timers at 60 Hz, and that
+*   listenUnix never replaces anything but a socket
+*   By Brian Mansfield
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "chip8.h"
+#include "stream.h"
+
+const char * SOCKET_PATH = "/tmp/chip8_stream_test.sock";
+
+// instance 0: draw the big font 0 one px further right each loop until key 0
+// is pressed, then switch to high-res and stop drawing
+const unsigned char scrollRom[] = {
+    0xA0, 0x50,     // 200: LD I, 0x050
+    0x60, 0x00,     // 202: LD V0, 0
+    0x61, 0x00,     // 204: LD V1, 0
+    0x00, 0xE0,     // 206: CLS
+    0xD0, 0x1A,     // 208: DRW V0, V1, 10
+    0x70, 0x01,     // 20A: ADD V0, 1
+    0xE2, 0x9E,     // 20C: SKP V2
+    0x12, 0x06,     // 20E: JP 0x206
+    0x00, 0xFF,     // 210: HIGH
+    0x12, 0x12      // 212: JP 0x212
+};
+
+// instance 1: wait for a key, draw, wait 30 frames on the delay timer, draw
+// again, stop
+const unsigned char timerRom[] = {
+    0xF4, 0x0A,     // 200: LD V4, K
+    0xA0, 0x50,     // 202: LD I, 0x050
+    0xD0, 0x1A,     // 204: DRW V0, V1, 10
+    0x62, 0x1E,     // 206: LD V2, 30
+    0xF2, 0x15,     // 208: LD DT, V2
+    0xF3, 0x07,     // 20A: LD V3, DT
+    0x33, 0x00,     // 20C: SE V3, 0
+    0x12, 0x0A,     // 20E: JP 0x20A
+    0xD0, 0x1A,     // 210: DRW V0, V1, 10
+    0x12, 0x12      // 212: JP 0x212
+};
+
+int failed = 0;
+
+static void check(bool ok, const char * what){
+    printf("%s  %s\n", ok ? "PASS" : "FAIL", what);
+    if (!ok)
+        ++failed;
+}
+
+static bool writeRom(const char * path, const unsigned char * rom, size_t size){
+    FILE * f = fopen(path, "wb");
+    if (!f)
+        return false;
+    fwrite(rom, 1, size, f);
+    fclose(f);
+    return true;
+}
+
+static bool fileHolds(const char * path, const unsigned char * data, size_t size){
+    FILE * f = fopen(path, "rb");
+    if (!f)
+        return false;
+    std::vector<unsigned char> buf(size + 1);
+    auto n = fread(buf.data(), 1, buf.size(), f);
+    fclose(f);
+    return n == size && !memcmp(buf.data(), data, size);
+}
+
+static bool readAll(int fd, unsigned char * buf, size_t size){
+    while (size > 0){
+        auto n = recv(fd, buf, size, 0);
+        if (n <= 0)
+            return false;
+        buf += n;
+        size -= n;
+    }
+    return true;
+}
+
+struct frame {
+    int hires;
+    std::vector<int> rows;      // plane << 7 | y of every row sent
+};
+
+// false on timeout or a malformed message
+static bool readFrame(int fd, frame& f){
+    unsigned char head[4];
+    if (!readAll(fd, head, sizeof(head)) || head[0] != 'F')
+        return false;
+    f.hires = head[1];
+    f.rows.clear();
+    int count = head[2] << 8 | head[3];
+    unsigned char row[17];
+    size_t size = f.hires ? 17 : 9;
+    for (auto i = 0; i < count; ++i){
+        if (!readAll(fd, row, size))
+            return false;
+        f.rows.push_back(row[0]);
+    }
+    return true;
+}
+
+static int connectViewer(int instance){
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, SOCKET_PATH, sizeof(addr.sun_path) - 1);
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0){
+        close(fd);
+        return -1;
+    }
+    timeval tv = { 2, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    unsigned char subscribe[3] = { 'S', (unsigned char)(instance >> 8), (unsigned char)instance };
+    send(fd, subscribe, sizeof(subscribe), 0);
+    return fd;
+}
+
+int main()
+{
+    if (!writeRom("/tmp/chip8_stream_scroll.ch8", scrollRom, sizeof(scrollRom)) ||
+        !writeRom("/tmp/chip8_stream_timer.ch8", timerRom, sizeof(timerRom)))
+        return 1;
+
+    chip8 * scroll = new chip8();
+    chip8 * timer = new chip8();
+    if (!scroll->loadApplication("/tmp/chip8_stream_scroll.ch8") ||
+        !timer->loadApplication("/tmp/chip8_stream_timer.ch8"))
+        return 1;
+
+    // a file where the socket should go, e.g. a ROM given as the first
+    // argument, must be left alone
+    const char * notSocket = "/tmp/chip8_stream_test.ch8";
+    writeRom(notSocket, timerRom, sizeof(timerRom));
+    std::string longPath(sizeof(sockaddr_un().sun_path), 'x');
+    bool refused;
+    {
+        chip8Server other;
+        refused = !other.listenUnix(notSocket) && !other.listenUnix(longPath.c_str());
+    }
+    bool intact = fileHolds(notSocket, timerRom, sizeof(timerRom));
+    unlink(notSocket);
+
+    chip8Server server;
+    if (!server.listenUnix(SOCKET_PATH))
+        return 1;
+    server.addInstance(scroll);
+    server.addInstance(timer);
+    server.start();
+    printf("\n");
+
+    check(refused && intact, "listenUnix refuses a regular file and an overlong path");
+
+    int fd = connectViewer(0);
+    check(fd >= 0, "viewer connects");
+    if (fd < 0)
+        return 1;
+
+    frame f;
+    bool ok = readFrame(fd, f);
+    check(ok && f.hires == 0 && f.rows.size() == 2 * SCREEN_HEIGHT, "subscribe sends a full low-res keyframe");
+
+    // the sprite moves every loop, so only its 10 rows change
+    ok = readFrame(fd, f);
+    bool rowsOk = ok && f.rows.size() == 10;
+    for (auto r : f.rows)
+        rowsOk = rowsOk && r < 10;
+    check(rowsOk, "next frame holds only the 10 changed rows");
+
+    // key 0 ends the loop, the mode switch must resend every row. frames
+    // already on the wire are still low-res deltas
+    unsigned char press[3] = { 'K', 0x0, 1 };
+    send(fd, press, sizeof(press), 0);
+    bool keyframe = false;
+    for (auto i = 0; i < 30 && readFrame(fd, f); ++i){
+        if (f.hires){
+            keyframe = f.rows.size() == 2 * HIRES_HEIGHT;
+            break;
+        }
+    }
+    check(keyframe, "'K' reaches the instance and the mode switch sends a high-res keyframe");
+
+    timeval tv = { 0, 300000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    check(!readFrame(fd, f), "nothing is sent while the instance doesn't draw");
+    close(fd);
+
+    // after the keyframe and a key press instance 1 draws twice, 30 delay
+    // timer ticks apart
+    fd = connectViewer(1);
+    ok = fd >= 0 && readFrame(fd, f);
+    send(fd, press, sizeof(press), 0);
+    ok = ok && readFrame(fd, f);
+    auto start = std::chrono::steady_clock::now();
+    ok = ok && readFrame(fd, f);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    check(ok && seconds > 0.4 && seconds < 1.0, "served instances run the delay timer at 60 Hz");
+    close(fd);
+
+    server.stop();
+    unlink(SOCKET_PATH);
+
+    printf("\n%s\n", failed ? "FAILED" : "OK");
+    return failed ? 1 : 0;
+}